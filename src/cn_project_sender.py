@@ -2,10 +2,27 @@
 # Termux / Python3 script to send a file to the C++ receiver that expects:
 # [4-byte big-endian length][payload bytes]
 # Optionally waits for a 1-byte ACK.
+#
+# Usage:
+#   python3 cn_project_sender.py                      (sends FILE_PATH)
+#   python3 cn_project_sender.py FILE|DIR... [-j N] [--host IP] [--port P]
+#                                [--no-ack] [--name] [--crc] [--compress] [--dict] [--sparse] [--tree]
+#   command | python3 cn_project_sender.py - [--host IP] [--port P] [--no-ack] [--name] [--clock]
+# Several files (directories are walked) are sent over N concurrent connections;
+# "-" streams stdin as it is produced, without knowing its size.
 
+import argparse
+import asyncio
+import concurrent.futures
+import errno
+import hashlib
 import socket
 import os
 import sys
+import time
+import random
+import threading
+import zlib
 
 # === CONFIGURE THESE ===
 SERVER_IP = "192.168.44.107" # Laptop's Bluetooth PAN IP
@@ -14,9 +31,235 @@ FILE_PATH = "/data/data/com.termux/files/home/storage/downloads/duckyfile.dd"
 
 SEND_ACK_EXPECTED = True # Set False if receiver started with --no-ack
 ACK_TIMEOUT_SECONDS = 5
+# The receiver ACKs only once the file is on its disk, so the wait for the ACK also
+# allows for writing the file at this rate (bytes/s) on a slow or busy disk.
+ACK_MIN_WRITE_RATE = 2 * 1024 * 1024
+
+# Concurrent connections when sending several files. The receiver takes one file
+# per connection, so this hides connect/ACK round trips; it needs a receiver
+# that handles connections in parallel (templated --out, --max-conns or --reactor).
+CONNECTIONS = 4
+
+# Send the file name in an extended header ("CNX1" + options) so a receiver with a
+# templated --out (e.g. "inbox\{seq:5}-{name}") can use it. Needs a receiver that
+# understands the header; leave False for older receivers.
+SEND_NAME = False
+
+# Also send the file's CRC-32 in the extended header; a receiver started with
+# --verify-crc then discards (and does not ACK) a payload that arrived damaged.
+SEND_CRC = False
+
+# Compress small files with raw deflate (EXT_DICT). With USE_DICT the sender first
+# fetches the dictionary the receiver trained from recent small payloads (receiver
+# --dict-dir DIR) and compresses against it, which is what makes snippets of a few
+# hundred bytes shrink. Either needs a receiver that understands the header.
+COMPRESS = False
+USE_DICT = False
+COMPRESS_MAX_BYTES = 64 * 1024  # larger files go uncompressed via sendfile
+
+# Sparse files (disk images, preallocated logs): send only the data extents, found
+# with SEEK_DATA/SEEK_HOLE plus all-zero blocks, and let the receiver recreate the
+# holes (EXT_SPARSE). Needs a receiver that understands the header.
+SEND_SPARSE = False
+SPARSE_BLOCK = 64 * 1024        # zero detection granularity
+SPARSE_MAX_EXTENTS = 4095       # the extent map has to fit one header option
+
+# Send a tree hash of each file (EXT_TREE) instead of one checksum. A receiver
+# started with --verify-tree checks it as the file arrives and asks for just the
+# leaves that came in damaged, which are re-sent on the same connection.
+SEND_TREE = False
+TREE_SHIFT = 16                 # 64 KB leaves
+
+# Streaming ("-" as the path): stdin goes out as length-prefixed chunks ended by
+# an empty one (EXT_CHUNKED), each as soon as the producer writes it, so command
+# output needs no temp file. Needs a receiver that understands the header.
+STREAM_CHUNK = 64 * 1024        # largest chunk; a pipe usually hands over less
+STREAM_NAME = "stdin.txt"       # file name sent with --name
+
+# With --clock the stream first measures the receiver's clock offset NTP-style
+# (EXT_CLOCK probes on the same connection), then stamps every chunk with its send
+# time (EXT_TIMED), so the receiver logs one-way latency and queueing delay per chunk.
+CLOCK_PROBES = 8
+CLOCK_PROBE_GAP = 0.05          # seconds between probes
+
+# Multicast mode: send the file ONCE to a group that many receivers joined with
+# --multicast GROUP:PORT. Missing blocks are repaired from the receivers' NACKs.
+MULTICAST_GROUP = None          # e.g. "239.255.44.1"; None = normal TCP send
+MULTICAST_PORT = 5002
+MULTICAST_RECEIVERS = 0         # ACKs to wait for (0 = stop once nobody reports gaps)
+MULTICAST_RATE_KBPS = 1500      # pacing; keep below the link rate to avoid losses
+MULTICAST_BLOCK_SIZE = 1200     # fits one Ethernet/PAN frame
+
+# Multipath mode: stripe one file over several links at once (receiver needs
+# --multipath). One (receiver IP, local IP to bind or None) pair per link, e.g.
+# [("192.168.44.107", None), ("10.0.0.12", "10.0.0.34")] for PAN + Wi-Fi.
+MULTIPATH_ROUTES = []
 
 # -------------------------
-def send_file(path, server_ip, port, expect_ack=True):
+def ext_header(name=None, crc=None, dict_id=None, raw_size=0, sparse=None, tree=None, chunked=False,
+               keep_open=False, clock=None, timed=None):
+    """Extended header: magic, TLV options [type:1][len:2 BE][value], end byte."""
+    h = b"CNX1"
+    if name is not None:
+        value = name.encode("utf-8")[:65535]
+        h += b"\x01" + len(value).to_bytes(2, byteorder='big') + value
+    if crc is not None:
+        h += b"\x03" + (4).to_bytes(2, byteorder='big') + crc.to_bytes(4, byteorder='big')
+    if dict_id is not None:
+        h += b"\x05" + (8).to_bytes(2, byteorder='big') + dict_id.to_bytes(4, 'big') + raw_size.to_bytes(4, 'big')
+    if sparse is not None:
+        size, extents = sparse
+        value = size.to_bytes(8, 'big') + b"".join(o.to_bytes(8, 'big') + n.to_bytes(8, 'big') for o, n in extents)
+        h += b"\x07" + len(value).to_bytes(2, byteorder='big') + value
+    if tree is not None:
+        shift, root = tree
+        h += b"\x08" + (33).to_bytes(2, byteorder='big') + bytes([shift]) + root
+    if chunked:
+        h += b"\x09" + (0).to_bytes(2, byteorder='big')
+    if keep_open:
+        h += b"\x04" + (0).to_bytes(2, byteorder='big')
+    if clock is not None:
+        h += b"\x0a" + (8).to_bytes(2, byteorder='big') + clock.to_bytes(8, 'big', signed=True)
+    if timed is not None:
+        offset, drift_ppb, ref, error = timed
+        h += (b"\x0b" + (24).to_bytes(2, byteorder='big') + offset.to_bytes(8, 'big', signed=True)
+              + drift_ppb.to_bytes(4, 'big', signed=True) + ref.to_bytes(8, 'big', signed=True)
+              + error.to_bytes(4, 'big'))
+    return h + b"\x00"
+
+REPLY_ACK, REPLY_NAK = b"\x01", b"\x03"
+NAK_DISK_FULL, NAK_REJECTED = 1, 4
+NAK_REASONS = {1: "disk full", 2: "write failed", 3: "integrity check failed", 4: "rejected by content filter"}
+
+class ReceiverNak(IOError):
+    """The receiver refused the file ([REPLY_NAK][reason]) instead of ACKing it."""
+    def __init__(self, reason):
+        super().__init__(f"receiver NAK: {NAK_REASONS.get(reason, f'reason {reason}')}")
+        self.reason = reason
+
+def ack_timeout(size):
+    return ACK_TIMEOUT_SECONDS + size / ACK_MIN_WRITE_RATE
+
+def tree_leaves(data, shift=TREE_SHIFT):
+    """Leaf hashes SHA-256(0x00 || leaf), on a thread pool (hashlib releases the GIL)."""
+    view, size = memoryview(data), 1 << shift
+    def leaf(off):
+        h = hashlib.sha256(b"\x00")
+        h.update(view[off:off + size])
+        return h.digest()
+    with concurrent.futures.ThreadPoolExecutor() as pool:
+        return list(pool.map(leaf, range(0, max(len(data), 1), size)))
+
+def tree_root(leaves):
+    """Parents are SHA-256(0x01 || left || right); the left subtree takes the largest
+    power of two below the leaf count (same shape as BLAKE3)."""
+    if len(leaves) == 1:
+        return leaves[0]
+    k = 1
+    while k * 2 < len(leaves):
+        k *= 2
+    return hashlib.sha256(b"\x01" + tree_root(leaves[:k]) + tree_root(leaves[k:])).digest()
+
+def recv_exact(s, n):
+    buf = b""
+    while len(buf) < n:
+        chunk = s.recv(n - len(buf))
+        if not chunk:
+            raise IOError("connection closed")
+        buf += chunk
+    return buf
+
+def fetch_dictionary(server_ip, port, have_id=0):
+    """Dictionary handshake (EXT_DICT_FETCH, no payload). Returns (id, bytes); id 0
+    means the receiver has none yet, empty bytes with have_id means it is current."""
+    with socket.create_connection((server_ip, port), timeout=10) as s:
+        s.sendall(b"CNX1" + b"\x06" + (4).to_bytes(2, 'big') + have_id.to_bytes(4, 'big') + b"\x00"
+                  + (0).to_bytes(4, 'big'))
+        head = recv_exact(s, 8)
+        dict_id, n = int.from_bytes(head[:4], 'big'), int.from_bytes(head[4:], 'big')
+        return dict_id, recv_exact(s, n)
+
+class Codec:
+    """Raw deflate, against a preset dictionary when the receiver offered one."""
+    def __init__(self, dict_id=0, dictionary=b""):
+        self.dict_id, self.dictionary = dict_id, dictionary
+        self.raw = self.wire = 0
+
+    def compress(self, data):
+        if self.dictionary:
+            c = zlib.compressobj(9, zlib.DEFLATED, -15, 9, zlib.Z_DEFAULT_STRATEGY, self.dictionary)
+        else:
+            c = zlib.compressobj(9, zlib.DEFLATED, -15, 9)
+        return c.compress(data) + c.flush()
+
+def file_crc32(path):
+    crc = 0
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(65536), b""):
+            crc = zlib.crc32(chunk, crc)
+    return crc
+
+def data_extents(path, size):
+    """(offset, length) ranges that hold data according to SEEK_DATA/SEEK_HOLE; the
+    whole file where the platform or file system cannot tell."""
+    extents = []
+    try:
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            off = 0
+            while off < size:
+                try:
+                    start = os.lseek(fd, off, os.SEEK_DATA)
+                except OSError as e:
+                    if e.errno == errno.ENXIO:  # only a hole is left
+                        break
+                    raise
+                off = os.lseek(fd, start, os.SEEK_HOLE)
+                extents.append((start, off - start))
+        finally:
+            os.close(fd)
+    except (AttributeError, OSError):
+        return [(0, size)] if size else []
+    return extents
+
+def sparse_frame(path):
+    """Extent map and data of a file with holes: (size, [(offset, length)], data), or
+    None when there is nothing to skip. All-zero blocks inside data extents count as
+    holes too (preallocated or zero-filled regions)."""
+    size = os.path.getsize(path)
+    zero = bytes(SPARSE_BLOCK)
+    runs = []  # [offset, bytearray]
+    with open(path, "rb") as f:
+        for off, length in data_extents(path, size):
+            f.seek(off)
+            pos, end = off, off + length
+            while pos < end:
+                block = f.read(min(SPARSE_BLOCK, end - pos))
+                if not block:
+                    break
+                if block != zero[:len(block)]:
+                    if runs and runs[-1][0] + len(runs[-1][1]) == pos:
+                        runs[-1][1] += block
+                    else:
+                        runs.append([pos, bytearray(block)])
+                pos += len(block)
+    if sum(len(r[1]) for r in runs) == size:
+        return None
+    if len(runs) > SPARSE_MAX_EXTENTS:
+        # too many extents for the header: fill in the smallest holes with their zeros
+        gaps = sorted(range(1, len(runs)), key=lambda i: runs[i][0] - runs[i - 1][0] - len(runs[i - 1][1]))
+        fill = set(gaps[:len(runs) - SPARSE_MAX_EXTENTS])
+        merged = [runs[0]]
+        for i in range(1, len(runs)):
+            if i in fill:
+                prev = merged[-1]
+                prev[1] += bytes(runs[i][0] - prev[0] - len(prev[1])) + runs[i][1]
+            else:
+                merged.append(runs[i])
+        runs = merged
+    return size, [(o, len(d)) for o, d in runs], b"".join(bytes(d) for _, d in runs)
+
+def send_file(path, server_ip, port, expect_ack=True, send_name=False, send_crc=False, sparse=False):
     if not os.path.isfile(path):
         print(f"[ERROR] File not found: {path}")
         return 1
@@ -31,30 +274,45 @@ def send_file(path, server_ip, port, expect_ack=True):
             s.settimeout(10)
             s.connect((server_ip, port))
 
-            # Send 4-byte big-endian length
-            length_prefix = file_size.to_bytes(4, byteorder='big')
-            s.sendall(length_prefix)
-            print(f"[INFO] Sent length prefix: {file_size} bytes")
+            frame = sparse_frame(path) if sparse else None
+            if frame is not None:
+                # Only the data extents; the receiver recreates the holes
+                size, extents, data = frame
+                s.sendall(ext_header(os.path.basename(path) if send_name else None,
+                                     zlib.crc32(data) if send_crc else None, sparse=(size, extents))
+                          + len(data).to_bytes(4, byteorder='big'))
+                print(f"[INFO] Sparse file: {len(data)} of {size} bytes in {len(extents)} data extents")
+                s.sendall(data)
+                sent = len(data)
+            else:
+                # Optional extended header carrying the file name and/or CRC-32
+                if send_name or send_crc:
+                    s.sendall(ext_header(os.path.basename(path) if send_name else None,
+                                         file_crc32(path) if send_crc else None))
 
-            # Send file in chunks
-            sent = 0
-            with open(path, "rb") as f:
-                while True:
-                    chunk = f.read(65536)
-                    if not chunk:
-                        break
-                    s.sendall(chunk)
-                    sent += len(chunk)
+                # Send 4-byte big-endian length
+                length_prefix = file_size.to_bytes(4, byteorder='big')
+                s.sendall(length_prefix)
+                print(f"[INFO] Sent length prefix: {file_size} bytes")
+
+                # Send the file straight from the page cache (sendfile), or in chunks
+                # where the platform has no zero-copy path
+                with open(path, "rb") as f:
+                    sent = s.sendfile(f)
 
             print(f"[OK] Sent file bytes: {sent}")
 
             # Wait for ACK
             if expect_ack:
-                s.settimeout(ACK_TIMEOUT_SECONDS)
+                s.settimeout(ack_timeout(file_size))
                 try:
                     ack = s.recv(1)
-                    if ack == b"\x01":
+                    if ack == REPLY_ACK:
                         print("[OK] ACK received from server.")
+                    elif ack == REPLY_NAK:
+                        reason = s.recv(1)
+                        print(f"[ERROR] Receiver did not keep the file: {ReceiverNak(reason[0] if reason else 0)}")
+                        return 3
                     else:
                         print(f"[WARN] Unexpected ACK: {ack!r}")
                 except socket.timeout:
@@ -68,5 +326,498 @@ def send_file(path, server_ip, port, expect_ack=True):
 
     return 0
 
+# -------------------------
+def now_us():
+    return time.time_ns() // 1000
+
+def clock_estimate(samples):
+    """Receiver clock relative to ours from (t1, t2, t3, t4) probes, as the receiver's
+    clock_estimate does it: the faster half of the probes, a least-squares line
+    through their offsets when they span a second or more. Returns
+    (offset_us, drift_ppb, ref_us, error_us)."""
+    by_rtt = sorted(samples, key=lambda c: (c[3] - c[0]) - (c[2] - c[1]))
+    t1, t2, t3, t4 = by_rtt[0]
+    ref = t1 + (t4 - t1) // 2
+    offset = ((t2 - t1) + (t3 - t4)) // 2
+    error = max((t4 - t1) - (t3 - t2), 0) // 2
+    kept = by_rtt[:(len(by_rtt) + 1) // 2]
+    xs = [c[0] + (c[3] - c[0]) // 2 - ref for c in kept]
+    ys = [((c[1] - c[0]) + (c[2] - c[3])) // 2 - offset for c in kept]
+    n, sx, sy = len(kept), sum(xs), sum(ys)
+    sxx, sxy = sum(x * x for x in xs), sum(x * y for x, y in zip(xs, ys))
+    drift = 0
+    if n >= 4 and max(xs + [0]) - min(xs + [0]) >= 1e6 and n * sxx - sx * sx > 0:
+        slope = max(-1e-3, min(1e-3, (n * sxy - sx * sy) / (n * sxx - sx * sx)))
+        drift = int(slope * 1e9)
+        offset += int((sy - slope * sx) / n)
+    return offset, drift, ref, error
+
+def probe_clock(s, probes=CLOCK_PROBES):
+    """EXT_CLOCK probes on a connected socket; the receiver replies t1, t2, t3."""
+    samples = []
+    for i in range(probes):
+        t1 = now_us()
+        s.sendall(ext_header(keep_open=True, clock=t1) + (0).to_bytes(4, 'big'))
+        reply = recv_exact(s, 24)
+        t4 = now_us()
+        samples.append((t1, int.from_bytes(reply[8:16], 'big', signed=True),
+                        int.from_bytes(reply[16:24], 'big', signed=True), t4))
+        if i + 1 < probes:
+            time.sleep(CLOCK_PROBE_GAP)
+    return clock_estimate(samples)
+
+def send_stream(fd, server_ip, port, expect_ack=True, send_name=False, timed=False):
+    """Sends what 'fd' (stdin) yields until EOF as one chunked frame:
+    [ext header][0][len][bytes]...[0]. Every read is forwarded at once, so the
+    receiver has a slow producer's first bytes long before the producer is done.
+    With timed, the clock offset is probed first and every chunk length is followed
+    by the chunk's send time."""
+    print(f"[INFO] Connecting to {server_ip}:{port} ...")
+    total = chunks = 0
+    first = None
+    try:
+        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+            s.settimeout(10)
+            s.connect((server_ip, port))
+            s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)  # a small chunk should not wait
+            model = None
+            if timed:
+                model = probe_clock(s)
+                print(f"[INFO] Receiver clock offset {model[0] / 1000:+.3f} ms (+/- {model[3] / 1000:.3f} ms)")
+            stamp = (lambda: now_us().to_bytes(8, 'big', signed=True)) if timed else (lambda: b"")
+            start = time.time()
+            s.sendall(ext_header(STREAM_NAME if send_name else None, chunked=True, timed=model)
+                      + (0).to_bytes(4, 'big'))
+            try:
+                while True:
+                    data = os.read(fd, STREAM_CHUNK)
+                    if not data:
+                        break
+                    if first is None:
+                        first = time.time() - start
+                    s.sendall(len(data).to_bytes(4, byteorder='big') + stamp() + data)
+                    total += len(data)
+                    chunks += 1
+                s.sendall((0).to_bytes(4, byteorder='big') + stamp())
+            except OSError as e:
+                # the receiver may have refused the file mid-stream (e.g. disk full)
+                s.settimeout(1)
+                reply = b""
+                try:
+                    reply = s.recv(2)
+                except OSError:
+                    pass
+                if reply[:1] == REPLY_NAK and len(reply) == 2:
+                    print(f"[ERROR] Receiver did not keep the stream: {ReceiverNak(reply[1])}")
+                    return 3
+                print("[ERROR] Stream interrupted:", e)
+                return 2
+            elapsed = max(time.time() - start, 1e-6)
+            print(f"[OK] Streamed {total} bytes in {chunks} chunks over {elapsed:.2f}s"
+                  + (f"; first chunk sent after {first * 1000:.0f} ms" if first is not None else ""))
+
+            if expect_ack:
+                s.settimeout(ack_timeout(total))
+                try:
+                    ack = s.recv(1)
+                    if ack == REPLY_ACK:
+                        print("[OK] ACK received from server.")
+                    elif ack == REPLY_NAK:
+                        reason = s.recv(1)
+                        print(f"[ERROR] Receiver did not keep the stream: {ReceiverNak(reason[0] if reason else 0)}")
+                        return 3
+                    else:
+                        print(f"[WARN] Unexpected ACK: {ack!r}")
+                except socket.timeout:
+                    print("[WARN] No ACK received (timeout).")
+    except Exception as e:
+        print("[ERROR] Network connection failed:", e)
+        return 2
+    return 0
+
+# -------------------------
+def collect_files(paths):
+    """Expands directories (recursively) into the files to send, largest first so
+    the last connection to finish is not stuck with a big file on its own."""
+    files = []
+    for p in paths:
+        if os.path.isdir(p):
+            for root, _, names in os.walk(p):
+                files.extend(os.path.join(root, n) for n in sorted(names))
+        elif os.path.isfile(p):
+            files.append(p)
+        else:
+            print(f"[WARN] Skipping {p}: not a file or directory")
+    files.sort(key=os.path.getsize, reverse=True)
+    return files
+
+async def send_one_async(path, server_ip, port, expect_ack, send_name, send_crc, codec=None, sparse=False,
+                         tree=False):
+    """One file on its own connection, legacy framing: [ext header][length][payload].
+    With a codec, a small file goes compressed when that makes it smaller; with
+    sparse, a file with holes goes as its data extents only; with tree, the payload
+    carries a tree hash and damaged leaves are re-sent when the receiver asks."""
+    size = os.path.getsize(path)
+    body = None
+    opts = {}
+    frame = sparse_frame(path) if sparse else None
+    if frame is not None:
+        _, extents, body = frame
+        opts["sparse"] = (size, extents)
+        print(f"[INFO] {path}: sparse, {len(body)} of {size} bytes in {len(extents)} data extents")
+    elif codec is not None and 0 < size <= COMPRESS_MAX_BYTES:
+        with open(path, "rb") as f:
+            raw = f.read()
+        packed = codec.compress(raw)
+        if len(packed) < len(raw):
+            body = packed
+            opts["dict_id"], opts["raw_size"] = codec.dict_id, len(raw)
+    leaves = None
+    if tree:
+        if body is None:
+            with open(path, "rb") as f:
+                body = f.read()
+        leaves = await asyncio.get_running_loop().run_in_executor(None, tree_leaves, body)
+        opts["tree"] = (TREE_SHIFT, tree_root(leaves))
+    header = b""
+    if send_name or send_crc or opts:
+        crc = None
+        if send_crc:
+            crc = zlib.crc32(body) if body is not None else file_crc32(path)
+        header = ext_header(os.path.basename(path) if send_name else None, crc, **opts)
+    reader, writer = await asyncio.wait_for(asyncio.open_connection(server_ip, port), 10)
+    try:
+        if body is not None:
+            writer.write(header + len(body).to_bytes(4, byteorder='big') + body)
+            await writer.drain()
+        else:
+            writer.write(header + size.to_bytes(4, byteorder='big'))
+            await writer.drain()
+            with open(path, "rb") as f:
+                await asyncio.get_running_loop().sendfile(writer.transport, f)
+        if expect_ack:
+            ack = await asyncio.wait_for(reader.readexactly(1), ack_timeout(size))
+            while ack == b"\x02" and leaves is not None:
+                # repair request: the receiver's leaf hashes; re-send the leaves that differ
+                count = int.from_bytes(await reader.readexactly(4), 'big')
+                theirs = await reader.readexactly(32 * count)
+                bad = [i for i, h in enumerate(leaves) if theirs[32 * i:32 * i + 32] != h]
+                step = 1 << TREE_SHIFT
+                writer.write(len(bad).to_bytes(4, 'big') +
+                             b"".join(i.to_bytes(4, 'big') + body[i * step:(i + 1) * step] for i in bad))
+                await writer.drain()
+                print(f"[INFO] {path}: re-sent {len(bad)} of {len(leaves)} leaves")
+                ack = await asyncio.wait_for(reader.readexactly(1), ack_timeout(size))
+            if ack == REPLY_NAK:
+                raise ReceiverNak((await reader.readexactly(1))[0])
+            if ack != REPLY_ACK:
+                raise IOError(f"unexpected ACK {ack!r}")
+    finally:
+        writer.close()
+    if codec is not None:
+        codec.raw += size
+        codec.wire += len(body) if body is not None else size
+    return size
+
+async def send_many_async(files, server_ip, port, connections, expect_ack, send_name, send_crc, codec=None,
+                          sparse=False, tree=False):
+    queue = asyncio.Queue()
+    for f in files:
+        queue.put_nowait(f)
+    failed = []
+
+    async def worker():
+        while not queue.empty():
+            path = queue.get_nowait()
+            t0 = time.time()
+            try:
+                size = await send_one_async(path, server_ip, port, expect_ack, send_name, send_crc, codec, sparse,
+                                            tree)
+            except Exception as e:
+                if isinstance(e, ReceiverNak) and e.reason == NAK_DISK_FULL:
+                    # every file after this one would be refused as well
+                    print(f"[ERROR] {path}: {e}; not sending the remaining {queue.qsize()} files")
+                    failed.append(path)
+                    while not queue.empty():
+                        failed.append(queue.get_nowait())
+                    continue
+                try:
+                    if codec is None or (isinstance(e, ReceiverNak) and e.reason == NAK_REJECTED):
+                        raise
+                    # e.g. the receiver retired our dictionary: resend uncompressed
+                    size = await send_one_async(path, server_ip, port, expect_ack, send_name, send_crc, None, sparse,
+                                                tree)
+                except Exception:
+                    print(f"[ERROR] {path}: {e}")
+                    failed.append(path)
+                    continue
+            dt = max(time.time() - t0, 1e-6)
+            print(f"[OK] {path}: {size} bytes in {dt * 1000:.1f} ms ({size / dt / 1e6:.2f} MB/s)")
+
+    await asyncio.gather(*(worker() for _ in range(max(1, min(connections, len(files))))))
+    return failed
+
+def send_many(files, server_ip, port, connections=CONNECTIONS, expect_ack=True, send_name=False, send_crc=False,
+              compress=False, use_dict=False, sparse=False, tree=False):
+    """Sends every file over up to 'connections' concurrent connections and reports
+    per-file and aggregate throughput."""
+    if not files:
+        print("[ERROR] No files to send")
+        return 1
+    total = sum(os.path.getsize(f) for f in files)
+    codec = None
+    if use_dict:
+        try:
+            codec = Codec(*fetch_dictionary(server_ip, port))
+            print(f"[INFO] Compression dictionary {codec.dict_id} ({len(codec.dictionary)} bytes)"
+                  if codec.dict_id else "[INFO] Receiver has no dictionary yet; plain deflate")
+        except Exception as e:
+            print(f"[WARN] Dictionary fetch failed ({e}); plain deflate")
+            codec = Codec()
+    elif compress:
+        codec = Codec()
+    print(f"[INFO] Sending {len(files)} files ({total} bytes) to {server_ip}:{port} "
+          f"over {min(connections, len(files))} connections ...")
+    start = time.time()
+    failed = asyncio.run(send_many_async(files, server_ip, port, connections, expect_ack, send_name, send_crc, codec,
+                                         sparse, tree))
+    elapsed = max(time.time() - start, 1e-6)
+    if codec is not None and codec.raw:
+        print(f"[INFO] Compressed {codec.raw} -> {codec.wire} bytes ({codec.raw / max(codec.wire, 1):.2f}x)")
+    print(f"[{'ERROR' if failed else 'OK'}] {len(files) - len(failed)}/{len(files)} files, {total} bytes in {elapsed:.2f}s "
+          f"({total / elapsed / 1e6:.2f} MB/s, {len(files) / elapsed:.1f} files/s aggregate)")
+    return 2 if failed else 0
+
+# -------------------------
+MP_MIN_RANGE = 64 * 1024        # first (probe) range per link, and the smallest range
+MP_MAX_RANGE = 4 * 1024 * 1024
+MP_TARGET_SECONDS = 0.5         # aim for ranges that take about this long on their link
+
+def stripe_header(transfer_id, total, offset, name):
+    """Extended header for one multipath range: EXT_NAME + EXT_STRIPE options."""
+    value = transfer_id.to_bytes(8, 'big') + total.to_bytes(4, 'big') + offset.to_bytes(4, 'big')
+    n = name.encode("utf-8")[:65535]
+    return (b"CNX1" + b"\x01" + len(n).to_bytes(2, 'big') + n
+            + b"\x02" + len(value).to_bytes(2, 'big') + value + b"\x00")
+
+def send_multipath(path, routes, port, expect_ack=True):
+    """Stripe 'path' over several links. Each link pulls the next byte range sized
+    by its share of the measured aggregate throughput (minus connection RTT), so
+    faster links carry proportionally more; a failed range is retried elsewhere."""
+    if not os.path.isfile(path):
+        print(f"[ERROR] File not found: {path}")
+        return 1
+    with open(path, "rb") as f:
+        data = f.read()
+    total = len(data)
+    if total == 0:
+        print("[ERROR] Multipath needs a non-empty file")
+        return 1
+
+    transfer_id = random.getrandbits(64)
+    name = os.path.basename(path)
+    lock = threading.Lock()
+    state = {"next": 0, "retry": [], "acked": 0, "inflight": 0}
+    rates = [0.0] * len(routes)          # measured bytes/s per link (0 = not yet known)
+    sent_per_link = [0] * len(routes)
+    start = time.time()
+
+    def take_range(i, rtt):
+        with lock:
+            if state["retry"]:
+                state["inflight"] += 1
+                return state["retry"].pop()
+            remaining = total - state["next"]
+            if remaining <= 0:
+                # stay around while another link might still hand a range back
+                return "wait" if state["inflight"] else None
+            if rates[i] == 0.0:
+                size = MP_MIN_RANGE
+            else:
+                # this link's share of what is left, bounded by what it moves in ~MP_TARGET_SECONDS
+                share = rates[i] / sum(r for r in rates if r > 0)
+                size = int(min(share * remaining, rates[i] * max(MP_TARGET_SECONDS - rtt, 0.05)))
+                size = max(MP_MIN_RANGE, min(size, MP_MAX_RANGE))
+            size = min(size, remaining)
+            rng = (state["next"], size)
+            state["next"] += size
+            state["inflight"] += 1
+            return rng
+
+    def link_worker(i, server_ip, local_ip):
+        rtt = 0.0
+        while True:
+            rng = take_range(i, rtt)
+            if rng is None:
+                return
+            if rng == "wait":
+                time.sleep(0.05)
+                continue
+            offset, size = rng
+            try:
+                t0 = time.time()
+                with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+                    s.settimeout(10)
+                    if local_ip:
+                        s.bind((local_ip, 0))  # pin the connection to this interface
+                    s.connect((server_ip, port))
+                    t1 = time.time()
+                    s.sendall(stripe_header(transfer_id, total, offset, name) + size.to_bytes(4, 'big'))
+                    s.sendall(data[offset:offset + size])
+                    if expect_ack and s.recv(1) != b"\x01":
+                        raise IOError("no ACK")
+                t2 = time.time()
+            except Exception as e:
+                print(f"[WARN] Link {server_ip} failed ({e}); its range goes to the other links")
+                with lock:
+                    state["retry"].append(rng)
+                    state["inflight"] -= 1
+                return
+            rtt = 0.7 * rtt + 0.3 * (t1 - t0) if rtt else (t1 - t0)
+            with lock:
+                rate = size / max(t2 - t1, 1e-3)
+                rates[i] = 0.5 * rates[i] + 0.5 * rate if rates[i] else rate
+                sent_per_link[i] += size
+                state["acked"] += size
+                state["inflight"] -= 1
+
+    threads = [threading.Thread(target=link_worker, args=(i, ip, local)) for i, (ip, local) in enumerate(routes)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    elapsed = time.time() - start
+    for i, (ip, _) in enumerate(routes):
+        print(f"[INFO] Link {ip}: {sent_per_link[i]} bytes, ~{rates[i] / 1e6:.2f} MB/s")
+    if state["acked"] != total:
+        print(f"[ERROR] Multipath transfer incomplete ({state['acked']}/{total} bytes)")
+        return 2
+    print(f"[OK] Sent {total} bytes over {len(routes)} links in {elapsed:.2f}s "
+          f"({total / elapsed / 1e6:.2f} MB/s aggregate)")
+    return 0
+
+# -------------------------
+MC_MAGIC = b"CNMC"
+MC_DATA, MC_QUERY, MC_NACK, MC_ACK, MC_REJECT = 1, 2, 3, 4, 5
+
+def mc_packet(ptype, session, total, block_size, index, name=b"", body=b""):
+    """Datagram header shared with the receiver: see 'Multicast receiver' in the C++ file."""
+    return (MC_MAGIC + bytes([ptype]) + session.to_bytes(4, 'big') + total.to_bytes(4, 'big')
+            + block_size.to_bytes(2, 'big') + bytes([len(name)]) + index.to_bytes(4, 'big') + name + body)
+
+def send_multicast(path, group, port, receivers=0, rate_kbps=MULTICAST_RATE_KBPS,
+                   block_size=MULTICAST_BLOCK_SIZE, max_rounds=100):
+    if not os.path.isfile(path):
+        print(f"[ERROR] File not found: {path}")
+        return 1
+    with open(path, "rb") as f:
+        data = f.read()
+    if not data:
+        print("[ERROR] Multicast needs a non-empty file")
+        return 1
+
+    total = len(data)
+    blocks = (total + block_size - 1) // block_size
+    session = random.getrandbits(32)
+    name = os.path.basename(path).encode("utf-8")[:255]
+    gap = (block_size * 8 / (rate_kbps * 1000.0)) if rate_kbps else 0.0
+
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    s.bind(("", 0))
+    dest = (group, port)
+    sent_bytes = 0
+    start = time.time()
+
+    def send_blocks(indexes):
+        nonlocal sent_bytes
+        next_at = time.time()
+        for i in indexes:
+            pkt = mc_packet(MC_DATA, session, total, block_size, i, name,
+                            data[i * block_size:(i + 1) * block_size])
+            s.sendto(pkt, dest)
+            sent_bytes += len(pkt)
+            next_at += gap
+            delay = next_at - time.time()
+            if delay > 0:
+                time.sleep(delay)
+
+    print(f"[INFO] Multicasting {total} bytes ({blocks} blocks) to {group}:{port} ...")
+    send_blocks(range(blocks))
+
+    # repair rounds: ask who is missing what, re-send the union of the gaps
+    acked = set()
+    rejected = {}  # receiver -> NAK reason: it has every block but did not save the file
+    quiet_rounds = 0
+    for _ in range(max_rounds):
+        s.sendto(mc_packet(MC_QUERY, session, total, block_size, 0, name), dest)
+        missing = set()
+        deadline = time.time() + 0.3
+        while time.time() < deadline:
+            s.settimeout(max(0.01, deadline - time.time()))
+            try:
+                pkt, addr = s.recvfrom(65536)
+            except socket.timeout:
+                break
+            if len(pkt) < 20 or pkt[:4] != MC_MAGIC or int.from_bytes(pkt[5:9], 'big') != session:
+                continue
+            body = pkt[20 + pkt[15]:]
+            if pkt[4] == MC_ACK:
+                acked.add((addr, pkt[16:20]))  # receiver id: several may share one address
+            elif pkt[4] == MC_REJECT and body:
+                if (addr, pkt[16:20]) not in rejected:
+                    print(f"[WARN] Receiver {addr[0]}: {NAK_REASONS.get(body[0], f'reason {body[0]}')}")
+                rejected[(addr, pkt[16:20])] = body[0]
+            elif pkt[4] == MC_NACK:
+                for k in range(0, len(body) - 7, 8):
+                    first = int.from_bytes(body[k:k + 4], 'big')
+                    count = int.from_bytes(body[k + 4:k + 8], 'big')
+                    missing.update(range(first, min(first + count, blocks)))
+        if receivers and len(acked) + len(rejected) >= receivers:
+            break
+        if not missing:
+            quiet_rounds += 1
+            if not receivers and quiet_rounds >= 2:
+                break
+            continue
+        quiet_rounds = 0
+        send_blocks(sorted(missing))
+
+    elapsed = time.time() - start
+    s.close()
+    print(f"[OK] Multicast done in {elapsed:.2f}s: {len(acked)} ACK(s), {len(rejected)} rejected, "
+          f"{sent_bytes} bytes on air ({sent_bytes / total:.2f}x file size)")
+    return 0 if (not receivers or len(acked) >= receivers) else 3
+
 if __name__ == "__main__":
-    sys.exit(send_file(FILE_PATH, SERVER_IP, PORT, SEND_ACK_EXPECTED))
\ No newline at end of file
+    ap = argparse.ArgumentParser(description="Send files to the receiver.")
+    ap.add_argument("paths", nargs="*", help="files or directories, or - for stdin (default: FILE_PATH)")
+    ap.add_argument("--host", default=SERVER_IP)
+    ap.add_argument("--port", type=int, default=PORT)
+    ap.add_argument("-j", "--connections", type=int, default=CONNECTIONS)
+    ap.add_argument("--no-ack", action="store_true", help="receiver runs with --no-ack")
+    ap.add_argument("--name", action="store_true", default=SEND_NAME, help="send file names")
+    ap.add_argument("--crc", action="store_true", default=SEND_CRC, help="send CRC-32s")
+    ap.add_argument("--compress", action="store_true", default=COMPRESS, help="deflate small files")
+    ap.add_argument("--dict", action="store_true", default=USE_DICT,
+                    help="deflate small files against the receiver's trained dictionary")
+    ap.add_argument("--sparse", action="store_true", default=SEND_SPARSE, help="skip holes and zero blocks")
+    ap.add_argument("--tree", action="store_true", default=SEND_TREE,
+                    help="send tree hashes; re-send damaged ranges on request")
+    ap.add_argument("--clock", action="store_true",
+                    help="with -: measure the clock offset and time-stamp chunks (one-way latency)")
+    args = ap.parse_args()
+    SERVER_IP, PORT = args.host, args.port
+    SEND_ACK_EXPECTED = SEND_ACK_EXPECTED and not args.no_ack
+    if args.paths == ["-"]:
+        sys.exit(send_stream(sys.stdin.fileno(), SERVER_IP, PORT, SEND_ACK_EXPECTED, args.name, args.clock))
+    if args.paths:
+        sys.exit(send_many(collect_files(args.paths), SERVER_IP, PORT, args.connections,
+                           SEND_ACK_EXPECTED, args.name, args.crc, args.compress, args.dict, args.sparse,
+                           args.tree))
+    if MULTIPATH_ROUTES:
+        sys.exit(send_multipath(FILE_PATH, MULTIPATH_ROUTES, PORT, SEND_ACK_EXPECTED))
+    if MULTICAST_GROUP:
+        sys.exit(send_multicast(FILE_PATH, MULTICAST_GROUP, MULTICAST_PORT, MULTICAST_RECEIVERS))
+    sys.exit(send_file(FILE_PATH, SERVER_IP, PORT, SEND_ACK_EXPECTED, args.name, args.crc, args.sparse))
\ No newline at end of file
@@ -0,0 +1,827 @@
+// sync_agent.cpp
+// -----------------------------------------------------------------------------
+// Directory-watch sync client for the receiver (Linux / Android / Termux)
+// -----------------------------------------------------------------------------
+// Keeps a folder (e.g. notes) mirrored on the laptop without rerunning the sender:
+//  - Watches DIR and its subdirectories with inotify.
+//  - Debounces bursts of changes (an editor's save is several events) and pushes
+//    only files whose contents changed, judged against a local state DB of hashes.
+//  - Pushes over ONE persistent connection: every frame carries EXT_KEEP_OPEN, so
+//    the receiver reads the next frame from the same socket after its ACK.
+//  - Reports sync lag per file: time from the file's last write to the receiver's
+//    ACK, i.e. until the file is committed on the laptop.
+//  - With --serve PORT also answers the receiver's pull requests (receiver.exe
+//    --pull-agent PHONE:PORT): files asked for by name or glob are sent back.
+// Frames use the receiver's extended header: EXT_NAME (relative path), EXT_CRC32,
+// EXT_KEEP_OPEN. Run the receiver with a {path} template to keep the folder layout:
+//   receiver.exe --out "notes\{path}" --max-conns 4 --verify-crc
+// -----------------------------------------------------------------------------
+// Usage / build:
+//   clang++ -std=c++17 -O2 sync_agent.cpp -o sync_agent      (Termux: pkg install clang)
+//   ./sync_agent DIR HOST [--port 5001] [--debounce MS] [--state FILE] [--no-ack]
+//                         [--once] [--bench N] [--serve PORT] [--bind ADDR]
+//     --once      push what changed since the last run, then exit (no watching)
+//     --serve P   also listen on port P for pull requests from the receiver
+//     --bind A    address --serve listens on (default 127.0.0.1; no authentication,
+//                 so name only an interface the laptop alone reaches, e.g. the PAN)
+//     --bench N   save N files into DIR/cn_sync_bench/ one by one, then report the
+//                 save -> committed-on-receiver latency (p50 / p95 / max)
+// Empty files are not pushed (the receiver takes no zero-length frames) and a file
+// the receiver's content filter rejects is not retried until it changes again; any
+// other failed push stays pending. --once exits with 0 when everything is up to
+// date on the receiver and 3 when some push is still pending.
+// -----------------------------------------------------------------------------
+
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+
+// ------------------------- Configuration defaults ----------------------------
+static const uint16_t PORT_DEFAULT = 5001;
+static const int DEBOUNCE_MS_DEFAULT = 300;        // quiet time before a burst is pushed
+static const int DEBOUNCE_MAX_FACTOR = 10;         // ...but never hold a change longer than 10x that
+static const int ACK_TIMEOUT_SECONDS = 10;
+static const int IDLE_CLOSE_SECONDS = 100;         // below the receiver's 120 s keep-open limit
+static const uint64_t MAX_PAYLOAD = 50u * 1024u * 1024u; // the receiver rejects larger frames
+static const char *STATE_NAME = ".cn_sync_state";  // default state DB inside DIR (never synced)
+static const char *BENCH_DIR = "cn_sync_bench";
+static const size_t PULL_MAX_FILES = 64;           // files sent for one pull request, at most
+
+// Extended header (see "Extended framing" in receiver_win32_fixed.cpp)
+static const uint32_t EXT_MAGIC = 0x434E5831; // "CNX1"
+static const uint32_t PULL_MAGIC = 0x434E5031; // "CNP1" pull request (see "Pull requests")
+enum ExtOption { EXT_END = 0, EXT_NAME = 1, EXT_CRC32 = 3, EXT_KEEP_OPEN = 4 };
+static const uint8_t REPLY_ACK = 0x01;
+static const uint8_t REPLY_NAK = 0x03;        // followed by a reason byte
+static const uint8_t NAK_REJECTED = 4;        // content filter: resending will not help
+
+// ------------------------------ Logging helpers ------------------------------
+
+void log_msg_str(const char *level, const std::string &msg) {
+    time_t now = time(NULL);
+    struct tm lt;
+    localtime_r(&now, &lt);
+    char timebuf[32];
+    strftime(timebuf, sizeof(timebuf), "%F %T", &lt);
+
+    std::ostringstream oss;
+    oss << timebuf << " [" << level << "] " << msg << "\n";
+    std::string s = oss.str();
+    fwrite(s.c_str(), 1, s.size(), strcmp(level, "ERROR") == 0 ? stderr : stdout);
+    fflush(stdout);
+}
+
+#define log_info(s) log_msg_str("INFO", (s))
+#define log_warn(s) log_msg_str("WARN", (s))
+#define log_err(s)  log_msg_str("ERROR", (s))
+
+// Monotonic milliseconds (debounce timing) and wall-clock nanoseconds (lag vs mtime).
+int64_t mono_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int64_t wall_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// ------------------------------ Hashing --------------------------------------
+
+// FNV-1a 64: content fingerprint for the state DB (change detection, not security).
+uint64_t fnv1a64(const std::vector<uint8_t> &data) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < data.size(); ++i) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// crc32_update: standard CRC-32 (IEEE, reflected), same as the receiver's.
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+    static struct Table {
+        uint32_t v[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                v[i] = c;
+            }
+        }
+    } table;
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) crc = table.v[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// ------------------------------ State DB -------------------------------------
+// One line per synced file: "<hash hex> <size> <mtime ns> <relative path>". The
+// size/mtime pair lets unchanged files be skipped without reading them; the hash
+// catches saves that did not change the contents (touch, editor re-save).
+
+struct FileState {
+    uint64_t hash;
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+typedef std::map<std::string, FileState> StateDb;
+
+bool state_load(const std::string &path, StateDb &db) {
+    std::ifstream in(path.c_str());
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string hex;
+        FileState st;
+        if (!(ls >> hex >> st.size >> st.mtime_ns)) continue;
+        st.hash = strtoull(hex.c_str(), NULL, 16);
+        std::string rel;
+        std::getline(ls, rel);
+        if (rel.size() > 1) db[rel.substr(1)] = st;
+    }
+    return true;
+}
+
+// state_save: write-then-rename so a crash never leaves a truncated DB.
+bool state_save(const std::string &path, const StateDb &db) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp.c_str(), std::ios::trunc);
+        if (!out) return false;
+        for (StateDb::const_iterator it = db.begin(); it != db.end(); ++it) {
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(it->second.hash));
+            out << hex << " " << it->second.size << " " << it->second.mtime_ns << " " << it->first << "\n";
+        }
+        if (!out) return false;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// ------------------------------ Directory walking ----------------------------
+
+// skip_name: dot files (including the state DB) and editor temporaries are not synced.
+bool skip_name(const std::string &name) {
+    if (name.empty() || name[0] == '.') return true;
+    if (name[name.size() - 1] == '~') return true;
+    size_t dot = name.rfind('.');
+    std::string ext = (dot == std::string::npos) ? std::string() : name.substr(dot);
+    return ext == ".swp" || ext == ".swx" || ext == ".tmp" || ext == ".part";
+}
+
+std::string join_path(const std::string &a, const std::string &b) {
+    if (a.empty()) return b;
+    return a + "/" + b;
+}
+
+// list_tree: every regular file (relative path) and directory (relative, "" = root) below root.
+// Symbolic links are not followed: a link cycle (loop -> .) would list the tree
+// over and over, and a link out of the root would sync files from elsewhere.
+void list_tree(const std::string &root, const std::string &rel, std::vector<std::string> &files,
+               std::vector<std::string> &dirs) {
+    dirs.push_back(rel);
+    DIR *d = opendir(join_path(root, rel).c_str());
+    if (!d) return;
+    while (dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (skip_name(name)) continue;
+        std::string child = join_path(rel, name);
+        struct stat st;
+        if (lstat(join_path(root, child).c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) list_tree(root, child, files, dirs);
+        else if (S_ISREG(st.st_mode)) files.push_back(child);
+    }
+    closedir(d);
+}
+
+bool read_file(const std::string &path, std::vector<uint8_t> &out) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) return false;
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+// ------------------------------ Connection -----------------------------------
+// One persistent TCP connection. A frame that cannot be sent or ACKed (the
+// receiver restarted or dropped an idle connection) is retried once on a fresh one.
+
+struct Link {
+    std::string host;
+    uint16_t port;
+    bool expect_ack;
+    int fd;
+    int64_t last_used_ms;
+};
+
+bool send_all(int fd, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void link_close(Link &l) {
+    if (l.fd >= 0) close(l.fd);
+    l.fd = -1;
+}
+
+bool link_connect(Link &l) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *res = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%u", l.port);
+    if (getaddrinfo(l.host.c_str(), port, &hints, &res) != 0 || !res) {
+        log_err("Cannot resolve " + l.host);
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    bool ok = fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    if (!ok) {
+        if (fd >= 0) close(fd);
+        std::ostringstream os; os << "Connect to " << l.host << ":" << l.port << " failed: " << strerror(errno);
+        log_warn(os.str());
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // small frames, latency matters
+    timeval tv;
+    tv.tv_sec = ACK_TIMEOUT_SECONDS;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    l.fd = fd;
+    return true;
+}
+
+void put_option(std::vector<uint8_t> &h, uint8_t type, const uint8_t *value, size_t len) {
+    h.push_back(type);
+    h.push_back(static_cast<uint8_t>(len >> 8));
+    h.push_back(static_cast<uint8_t>(len & 0xFF));
+    h.insert(h.end(), value, value + len);
+}
+
+void put_u32(std::vector<uint8_t> &h, uint32_t v) {
+    for (int i = 3; i >= 0; --i) h.push_back(static_cast<uint8_t>((v >> (8 * i)) & 0xFF));
+}
+
+// frame_header: [CNX1][NAME][CRC32][KEEP_OPEN][END][length] for one file's payload.
+std::vector<uint8_t> frame_header(const std::string &rel, const std::vector<uint8_t> &data, bool keep_open) {
+    std::vector<uint8_t> frame;
+    put_u32(frame, EXT_MAGIC);
+    put_option(frame, EXT_NAME, reinterpret_cast<const uint8_t*>(rel.data()), std::min<size_t>(rel.size(), 0xFFFF));
+    std::vector<uint8_t> crc;
+    put_u32(crc, crc32_update(0, data.data(), data.size()));
+    put_option(frame, EXT_CRC32, crc.data(), crc.size());
+    if (keep_open) put_option(frame, EXT_KEEP_OPEN, NULL, 0);
+    frame.push_back(EXT_END);
+    put_u32(frame, static_cast<uint32_t>(data.size()));
+    return frame;
+}
+
+enum PushResult { PUSH_OK, PUSH_FAILED, PUSH_REJECTED };
+
+// link_push: one frame and its ACK. A NAK for a rejected payload is final; the
+// receiver closes the connection after any NAK.
+PushResult link_push(Link &l, const std::string &rel, const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> frame = frame_header(rel, data, true);
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (l.fd >= 0 && mono_ms() - l.last_used_ms > IDLE_CLOSE_SECONDS * 1000) link_close(l);
+        if (l.fd < 0 && !link_connect(l)) return PUSH_FAILED;
+        bool ok = send_all(l.fd, frame.data(), frame.size()) && send_all(l.fd, data.data(), data.size());
+        if (ok && l.expect_ack) {
+            uint8_t reply[2] = { 0, 0 };
+            ok = ::recv(l.fd, reply, 1, 0) == 1 && reply[0] == REPLY_ACK;
+            if (!ok && reply[0] == REPLY_NAK && ::recv(l.fd, reply + 1, 1, 0) == 1 && reply[1] == NAK_REJECTED) {
+                link_close(l);
+                return PUSH_REJECTED;
+            }
+        }
+        if (ok) {
+            l.last_used_ms = mono_ms();
+            return PUSH_OK;
+        }
+        link_close(l); // stale or broken: reconnect and resend once
+    }
+    return PUSH_FAILED;
+}
+
+// ------------------------------ Sync engine ----------------------------------
+
+struct SyncStats {
+    std::vector<double> lag_ms;   // save -> committed, one entry per pushed file
+    uint64_t pushed;
+    uint64_t skipped;
+    uint64_t bytes;
+    uint64_t failed;
+    uint64_t rejected;            // refused by the receiver's content filter (not retried)
+};
+
+// Pending change: a burst of events on one file collapses into one entry.
+struct Pending {
+    int64_t first_ms;  // first event of the burst
+    int64_t last_ms;   // latest event; the file is pushed once it has been quiet
+};
+
+struct Agent {
+    std::string root;
+    std::string state_path;
+    StateDb db;
+    Link link;
+    SyncStats stats;
+    int inotify_fd;
+    std::map<int, std::string> watches;      // watch descriptor -> relative directory
+    std::map<std::string, Pending> pending;  // relative path -> burst timing (mono ms)
+    int debounce_ms;
+};
+
+// sync_file: pushes 'rel' if its contents differ from the state DB. Returns true
+// when nothing is left to retry: pushed now, unchanged, empty or rejected (the
+// last two are recorded, so they are looked at again only once they change).
+bool sync_file(Agent &a, const std::string &rel) {
+    std::string full = join_path(a.root, rel);
+    struct stat st;
+    if (lstat(full.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return true; // deleted meanwhile, or a symlink
+    int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+
+    StateDb::iterator it = a.db.find(rel);
+    if (it != a.db.end() && it->second.size == static_cast<uint64_t>(st.st_size) && it->second.mtime_ns == mtime_ns) {
+        ++a.stats.skipped;
+        return true;
+    }
+    if (static_cast<uint64_t>(st.st_size) > MAX_PAYLOAD) {
+        log_warn("Skipping " + rel + ": larger than the receiver's 50 MB frame limit");
+        return true;
+    }
+    std::vector<uint8_t> data;
+    if (!read_file(full, data)) {
+        log_warn("Cannot read " + rel);
+        return false;
+    }
+    FileState fs;
+    fs.hash = fnv1a64(data);
+    fs.size = data.size();
+    fs.mtime_ns = mtime_ns;
+    if (it != a.db.end() && it->second.hash == fs.hash && it->second.size == fs.size) {
+        it->second = fs; // touched, not changed
+        ++a.stats.skipped;
+        return true;
+    }
+
+    if (data.empty()) {
+        a.db[rel] = fs;
+        ++a.stats.skipped;
+        log_info("Skipping " + rel + ": empty (the receiver takes no zero-length frames)");
+        return true;
+    }
+
+    PushResult pushed = link_push(a.link, rel, data);
+    if (pushed == PUSH_REJECTED) {
+        a.db[rel] = fs;
+        ++a.stats.rejected;
+        log_warn("Receiver rejected " + rel + " (content filter); not retried until it changes");
+        return true;
+    }
+    if (pushed != PUSH_OK) {
+        ++a.stats.failed;
+        log_err("Failed to push " + rel + " (kept pending)");
+        return false;
+    }
+    double lag = (wall_ns() - mtime_ns) / 1e6;
+    a.db[rel] = fs;
+    a.stats.lag_ms.push_back(lag);
+    ++a.stats.pushed;
+    a.stats.bytes += data.size();
+    std::ostringstream os;
+    os << "Synced " << rel << " (" << data.size() << " bytes), lag " << static_cast<int64_t>(lag) << " ms";
+    log_info(os.str());
+    return true;
+}
+
+// pending_due: mono time at which a pending file is pushed. A quiet period ends
+// its burst; a file that keeps changing is still pushed after the max factor.
+int64_t pending_due(const Agent &a, const Pending &p) {
+    return std::min(p.last_ms + a.debounce_ms, p.first_ms + a.debounce_ms * DEBOUNCE_MAX_FACTOR);
+}
+
+void mark_pending(Agent &a, const std::string &rel, int64_t now) {
+    std::map<std::string, Pending>::iterator it = a.pending.find(rel);
+    if (it == a.pending.end()) {
+        Pending p;
+        p.first_ms = p.last_ms = now;
+        a.pending[rel] = p;
+    } else {
+        it->second.last_ms = now;
+    }
+}
+
+// flush_pending: pushes every change that is due (all of them with force); a
+// failed push stays pending and is retried one debounce window later.
+void flush_pending(Agent &a, bool force) {
+    int64_t now = mono_ms();
+    bool changed = false;
+    std::map<std::string, Pending>::iterator it = a.pending.begin();
+    while (it != a.pending.end()) {
+        if (!force && pending_due(a, it->second) > now) {
+            ++it;
+            continue;
+        }
+        changed = true;
+        if (sync_file(a, it->first)) {
+            a.pending.erase(it++);
+        } else {
+            it->second.first_ms = it->second.last_ms = mono_ms();
+            ++it;
+        }
+    }
+    if (changed && !state_save(a.state_path, a.db)) log_warn("Cannot write state DB " + a.state_path);
+}
+
+void add_watch(Agent &a, const std::string &rel) {
+    int wd = inotify_add_watch(a.inotify_fd, join_path(a.root, rel).c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+    if (wd < 0) {
+        log_warn("Cannot watch " + (rel.empty() ? a.root : rel) + ": " + strerror(errno));
+        return;
+    }
+    a.watches[wd] = rel;
+}
+
+// initial_scan: queue everything that changed while the agent was not running.
+void initial_scan(Agent &a, bool watch) {
+    std::vector<std::string> files, dirs;
+    list_tree(a.root, "", files, dirs);
+    if (watch) for (size_t i = 0; i < dirs.size(); ++i) add_watch(a, dirs[i]);
+    int64_t now = mono_ms();
+    for (size_t i = 0; i < files.size(); ++i) mark_pending(a, files[i], now);
+}
+
+// drain_events: reads queued inotify events into the pending set.
+void drain_events(Agent &a) {
+    char buf[64 * 1024] __attribute__((aligned(__alignof__(inotify_event))));
+    for (;;) {
+        ssize_t n = read(a.inotify_fd, buf, sizeof(buf));
+        if (n <= 0) return;
+        for (char *p = buf; p < buf + n; ) {
+            inotify_event *ev = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                log_warn("inotify queue overflow; rescanning");
+                initial_scan(a, false);
+                continue;
+            }
+            std::map<int, std::string>::iterator w = a.watches.find(ev->wd);
+            if (w == a.watches.end() || ev->len == 0) continue;
+            std::string name = ev->name;
+            if (skip_name(name)) continue;
+            std::string rel = join_path(w->second, name);
+            int64_t now = mono_ms();
+            if (ev->mask & IN_ISDIR) {
+                // a new subdirectory: watch it, and pick up files created before the watch existed
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    std::vector<std::string> files, dirs;
+                    list_tree(a.root, rel, files, dirs);
+                    for (size_t i = 0; i < dirs.size(); ++i) add_watch(a, dirs[i]);
+                    for (size_t i = 0; i < files.size(); ++i) mark_pending(a, files[i], now);
+                }
+                continue;
+            }
+            if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) mark_pending(a, rel, now);
+        }
+    }
+}
+
+double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(q * (v.size() - 1) + 0.5);
+    return v[std::min(i, v.size() - 1)];
+}
+
+void report(const SyncStats &s) {
+    std::ostringstream os;
+    os << "Sync summary: " << s.pushed << " pushed (" << s.bytes << " bytes), " << s.skipped << " unchanged, "
+       << s.failed << " failed, " << s.rejected << " rejected; lag p50 " << static_cast<int64_t>(percentile(s.lag_ms, 0.5)) << " ms, p95 "
+       << static_cast<int64_t>(percentile(s.lag_ms, 0.95)) << " ms, max "
+       << static_cast<int64_t>(percentile(s.lag_ms, 1.0)) << " ms";
+    log_info(os.str());
+}
+
+static const char *BENCH_EMPTY = "empty.txt"; // saved first; must settle without a push
+
+// bench_writer: saves N small files into DIR/cn_sync_bench, one every 200 ms, the way
+// an editor would (write, close). The agent's normal path measures their lag. An
+// empty file goes first: it is never pushed and must not stay pending.
+void bench_writer(std::string dir, int n) {
+    mkdir(dir.c_str(), 0777);
+    usleep(500 * 1000); // let the agent add the watch for the new directory
+    std::ofstream(join_path(dir, BENCH_EMPTY).c_str(), std::ios::trunc).close();
+    for (int i = 0; i < n; ++i) {
+        std::ostringstream name; name << dir << "/note_" << i << ".txt";
+        std::ofstream out(name.str().c_str(), std::ios::trunc);
+        out << "saved at " << wall_ns() << "\n"; // unique per run, or the state DB would skip it
+        for (int k = 0; k < 64; ++k) out << "bench line " << k << " of note " << i << "\n";
+        out.close();
+        usleep(200 * 1000);
+    }
+}
+
+// ------------------------------ Pull server ----------------------------------
+// --serve PORT: the receiver asks for files instead of waiting for a push (see
+// "Pull requests" in receiver_win32_fixed.cpp). One request per connection:
+//   receiver -> agent   "CNP1" [pattern length:2][pattern]
+//   agent -> receiver   [count:4], then count frames as frame_header builds them
+//                       (no EXT_KEEP_OPEN; the receiver does not ACK them)
+// The pattern is a relative path or a glob; '*' and '?' do not match '/'. Empty
+// files and skipped names (dot files, editor temporaries) are never sent.
+// There is no authentication: the listener binds 127.0.0.1 unless --bind names the
+// address the laptop reaches the phone on (its Bluetooth PAN address, say), so the
+// synced folder is not offered to every network the phone joins.
+
+// glob_match: '*' is any run of characters, '?' any one, neither crosses a '/'.
+bool glob_match(const char *p, const char *s) {
+    for (; *p; ++p, ++s) {
+        if (*p == '*') {
+            for (;; ++s) {
+                if (glob_match(p + 1, s)) return true;
+                if (!*s || *s == '/') return false;
+            }
+        }
+        if (!*s) return false;
+        if (*p == '?' ? *s == '/' : *p != *s) return false;
+    }
+    return !*s;
+}
+
+// servable: the file 'rel' below root exists, is a regular non-empty file the agent
+// would sync, and stays inside root: no ".." and no symlink anywhere on the way
+// (a link such as x -> /etc/shadow would hand out a file from outside the root).
+bool servable(const std::string &root, const std::string &rel) {
+    if (rel.empty() || rel[0] == '/') return false;
+    std::string part;
+    struct stat st;
+    for (size_t i = 0; i <= rel.size(); ++i) {
+        if (i < rel.size() && rel[i] != '/') {
+            part += rel[i];
+            continue;
+        }
+        if (part == ".." || skip_name(part)) return false;
+        if (lstat(join_path(root, rel.substr(0, i)).c_str(), &st) != 0 || S_ISLNK(st.st_mode)) return false;
+        part.clear();
+    }
+    return S_ISREG(st.st_mode) && st.st_size > 0 && static_cast<uint64_t>(st.st_size) <= MAX_PAYLOAD;
+}
+
+bool recv_exact(int fd, void *dst, size_t len) {
+    uint8_t *p = reinterpret_cast<uint8_t*>(dst);
+    while (len > 0) {
+        ssize_t n = ::recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// serve_pull: answers one pull request on a connected socket.
+void serve_pull(std::string root, int fd) {
+    int64_t t0 = mono_ms();
+    uint8_t head[6];
+    std::string pattern;
+    if (recv_exact(fd, head, 6)) {
+        uint32_t magic = (static_cast<uint32_t>(head[0]) << 24) | (static_cast<uint32_t>(head[1]) << 16) |
+                         (static_cast<uint32_t>(head[2]) << 8) | head[3];
+        pattern.resize((static_cast<size_t>(head[4]) << 8) | head[5]);
+        if (magic != PULL_MAGIC || pattern.empty() || !recv_exact(fd, &pattern[0], pattern.size())) pattern.clear();
+    }
+    if (pattern.empty()) {
+        log_warn("Pull: malformed request; connection closed");
+        close(fd);
+        return;
+    }
+
+    std::vector<std::string> matches;
+    if (pattern.find_first_of("*?") == std::string::npos) {
+        if (servable(root, pattern)) matches.push_back(pattern);
+    } else {
+        std::vector<std::string> files, dirs;
+        list_tree(root, "", files, dirs);
+        std::sort(files.begin(), files.end());
+        for (size_t i = 0; i < files.size() && matches.size() < PULL_MAX_FILES; ++i) {
+            if (glob_match(pattern.c_str(), files[i].c_str()) && servable(root, files[i])) matches.push_back(files[i]);
+        }
+    }
+
+    std::vector<uint8_t> count;
+    put_u32(count, static_cast<uint32_t>(matches.size()));
+    bool ok = send_all(fd, count.data(), count.size());
+    uint64_t bytes = 0;
+    for (size_t i = 0; ok && i < matches.size(); ++i) {
+        std::vector<uint8_t> data;
+        // changed since it was matched: the receiver sees a short reply and reports it
+        ok = read_file(join_path(root, matches[i]), data) && !data.empty() && data.size() <= MAX_PAYLOAD;
+        std::vector<uint8_t> frame = ok ? frame_header(matches[i], data, false) : std::vector<uint8_t>();
+        ok = ok && send_all(fd, frame.data(), frame.size()) && send_all(fd, data.data(), data.size());
+        bytes += data.size();
+    }
+    close(fd);
+    std::ostringstream os;
+    os << "Pull '" << pattern << "': " << matches.size() << " file(s), " << bytes << " bytes in " << (mono_ms() - t0)
+       << " ms" << (ok ? "" : " (send failed)");
+    if (ok) log_info(os.str());
+    else log_warn(os.str());
+}
+
+// pull_server: accepts pull requests on bind_addr:port for as long as the agent runs.
+void pull_server(std::string root, in_addr bind_addr, uint16_t port) {
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr = bind_addr;
+    addr.sin_port = htons(port);
+    if (lfd < 0 || bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(lfd, 16) != 0) {
+        std::ostringstream os;
+        os << "--serve: cannot listen on " << inet_ntoa(bind_addr) << ":" << port << ": " << strerror(errno);
+        log_err(os.str());
+        if (lfd >= 0) close(lfd);
+        return;
+    }
+    std::ostringstream os; os << "Serving pull requests for " << root << " on " << inet_ntoa(bind_addr) << ":" << port;
+    log_info(os.str());
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            log_err(std::string("--serve: accept failed: ") + strerror(errno));
+            break;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        timeval tv;
+        tv.tv_sec = ACK_TIMEOUT_SECONDS;
+        tv.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        std::thread(serve_pull, root, fd).detach(); // prefetches arrive alongside the request they follow
+    }
+    close(lfd);
+}
+
+// ------------------------------ CLI / main ------------------------------------
+
+void print_usage(const char *prog) {
+    std::cout << "Usage: " << prog << " DIR HOST [--port PORT] [--debounce MS] [--state FILE] [--no-ack]\n"
+              << "       [--once] [--bench N] [--serve PORT] [--bind ADDR]\n";
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 2;
+    }
+    Agent a;
+    a.root = argv[1];
+    while (a.root.size() > 1 && a.root[a.root.size() - 1] == '/') a.root.erase(a.root.size() - 1);
+    a.link.host = argv[2];
+    a.link.port = PORT_DEFAULT;
+    a.link.expect_ack = true;
+    a.link.fd = -1;
+    a.link.last_used_ms = 0;
+    a.stats.pushed = a.stats.skipped = a.stats.bytes = a.stats.failed = a.stats.rejected = 0;
+    a.state_path = join_path(a.root, STATE_NAME);
+    a.debounce_ms = DEBOUNCE_MS_DEFAULT;
+    bool once = false;
+    int bench = 0;
+    int serve_port = 0;
+    in_addr serve_addr;
+    serve_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) a.link.port = static_cast<uint16_t>(atoi(argv[++i]));
+        else if (arg == "--debounce" && i + 1 < argc) a.debounce_ms = std::max(0, atoi(argv[++i]));
+        else if (arg == "--state" && i + 1 < argc) a.state_path = argv[++i];
+        else if (arg == "--no-ack") a.link.expect_ack = false;
+        else if (arg == "--once") once = true;
+        else if (arg == "--bench" && i + 1 < argc) bench = std::max(1, atoi(argv[++i]));
+        else if (arg == "--serve" && i + 1 < argc) {
+            serve_port = atoi(argv[++i]);
+            if (serve_port <= 0 || serve_port > 65535) { print_usage(argv[0]); return 2; }
+        }
+        else if (arg == "--bind" && i + 1 < argc) {
+            if (inet_pton(AF_INET, argv[++i], &serve_addr) != 1) { print_usage(argv[0]); return 2; }
+        }
+        else { print_usage(argv[0]); return 2; }
+    }
+
+    struct stat st;
+    if (stat(a.root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        log_err("Not a directory: " + a.root);
+        return 1;
+    }
+    if (state_load(a.state_path, a.db)) {
+        std::ostringstream os; os << "State DB " << a.state_path << ": " << a.db.size() << " files known";
+        log_info(os.str());
+    }
+
+    if (serve_port && once) log_warn("--serve is ignored with --once (the agent exits after pushing)");
+    else if (serve_port) std::thread(pull_server, a.root, serve_addr, static_cast<uint16_t>(serve_port)).detach();
+
+    a.inotify_fd = once ? -1 : inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (!once && a.inotify_fd < 0) {
+        log_err(std::string("inotify_init1 failed: ") + strerror(errno));
+        return 1;
+    }
+    initial_scan(a, !once);
+    flush_pending(a, true);
+    if (once) {
+        report(a.stats);
+        link_close(a.link);
+        return a.pending.empty() ? 0 : 3;
+    }
+
+    std::ostringstream os;
+    os << "Watching " << a.root << " (" << a.watches.size() << " directories, debounce " << a.debounce_ms << " ms)";
+    log_info(os.str());
+
+    std::thread bench_thread;
+    size_t bench_base = a.stats.lag_ms.size();
+    if (bench) bench_thread = std::thread(bench_writer, join_path(a.root, BENCH_DIR), bench);
+
+    int64_t last_report = mono_ms();
+    for (;;) {
+        // sleep until an event arrives or the earliest pending change is due
+        int64_t now = mono_ms();
+        int64_t due = now + 1000;
+        for (std::map<std::string, Pending>::iterator it = a.pending.begin(); it != a.pending.end(); ++it) {
+            due = std::min(due, pending_due(a, it->second));
+        }
+        pollfd pfd;
+        pfd.fd = a.inotify_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, static_cast<int>(std::max<int64_t>(0, due - now))) > 0) drain_events(a);
+        flush_pending(a, false);
+
+        now = mono_ms();
+        if (now - last_report >= 60000) {
+            report(a.stats);
+            last_report = now;
+        }
+        if (bench && a.stats.lag_ms.size() - bench_base >= static_cast<size_t>(bench)) break;
+    }
+
+    bench_thread.join();
+    SyncStats b = a.stats;
+    b.lag_ms.erase(b.lag_ms.begin(), b.lag_ms.begin() + bench_base);
+    std::ostringstream bs;
+    bs << "Benchmark: " << bench << " saves, save -> committed on receiver: p50 "
+       << percentile(b.lag_ms, 0.5) << " ms, p95 " << percentile(b.lag_ms, 0.95) << " ms, max "
+       << percentile(b.lag_ms, 1.0) << " ms (debounce " << a.debounce_ms << " ms)";
+    log_info(bs.str());
+    link_close(a.link);
+    std::string empty = join_path(BENCH_DIR, BENCH_EMPTY);
+    if (a.pending.count(empty) || !a.db.count(empty)) {
+        log_err("Benchmark: the empty file " + empty + " did not settle");
+        return 3;
+    }
+    return 0;
+}